@@ -0,0 +1,366 @@
+# Copyright 2013 The Flutter Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+"""Local content-addressed cache for build actions. See action_cache.gni.
+
+An action is keyed on the contents of its tool binary, its arguments, the
+contents of its declared inputs and the paths of its declared outputs. On a
+miss the action runs and its outputs and depfile are stored in the cache. On a
+hit they are restored by copy.
+
+Files discovered through the depfile are not known until the action has run,
+so each key maps to a small manifest of candidate results together with the
+digests of the depfile inputs they were produced from, similar to ccache's
+direct mode.
+
+The cache is bounded in size. When it grows past its limit, the least recently
+used results are evicted.
+
+Print the statistics of a cache with:
+  python action_cache.py --cache-dir <dir> --stats
+"""
+
+import argparse
+import contextlib
+import hashlib
+import json
+import os
+import shutil
+import sys
+import tempfile
+
+# Bump this whenever the key or the manifest format changes.
+_CACHE_VERSION = 1
+
+# Number of depfile variants remembered per key.
+_MAX_MANIFEST_ENTRIES = 8
+
+_HASH_BLOCK_SIZE = 2**20
+
+if sys.platform == 'win32':
+  import msvcrt
+
+  def _LockFile(lock_file):
+    lock_file.seek(0)
+    while True:
+      try:
+        msvcrt.locking(lock_file.fileno(), msvcrt.LK_LOCK, 1)
+        return
+      except OSError:
+        # LK_LOCK gives up after 10 seconds. Keep waiting.
+        pass
+
+  def _UnlockFile(lock_file):
+    lock_file.seek(0)
+    msvcrt.locking(lock_file.fileno(), msvcrt.LK_UNLCK, 1)
+else:
+  import fcntl
+
+  def _LockFile(lock_file):
+    fcntl.flock(lock_file, fcntl.LOCK_EX)
+
+  def _UnlockFile(lock_file):
+    fcntl.flock(lock_file, fcntl.LOCK_UN)
+
+
+def AddArguments(parser):
+  """Adds the flags that action_cache.gni passes to the runner scripts."""
+  parser.add_argument('--cache-dir', help='Root directory of the cache.')
+  parser.add_argument('--cache-max-size-mb',
+                      type=int,
+                      default=10240,
+                      help='Evict results once the cache grows past this.')
+  parser.add_argument('--cache-input',
+                      action='append',
+                      default=[],
+                      help='A declared input of the action.')
+  parser.add_argument('--cache-output',
+                      action='append',
+                      default=[],
+                      help='A declared output of the action.')
+  parser.add_argument('--cache-depfile', help='The depfile of the action.')
+
+
+def _HashFile(path):
+  digest = hashlib.sha256()
+  with open(path, 'rb') as infile:
+    while True:
+      data = infile.read(_HASH_BLOCK_SIZE)
+      if not data:
+        break
+      digest.update(data)
+  return digest.hexdigest()
+
+
+def _ParseDepfile(path):
+  """Returns the dependencies listed in a Makefile-style depfile."""
+  with open(path, 'r') as depfile:
+    contents = depfile.read().replace('\\\n', ' ')
+  deps = []
+  for line in contents.splitlines():
+    _, sep, rest = line.partition(': ')
+    if not sep:
+      continue
+    # Undo the escaping of spaces in paths.
+    token = ''
+    for part in rest.split(' '):
+      if part.endswith('\\'):
+        token += part[:-1] + ' '
+        continue
+      token += part
+      if token:
+        deps.append(token)
+      token = ''
+  return deps
+
+
+def _Unlink(path):
+  try:
+    os.unlink(path)
+  except FileNotFoundError:
+    pass
+
+
+def _Restore(blob, path):
+  """Restores a cached blob to path. Raises FileNotFoundError if the blob was
+  evicted."""
+  dirname = os.path.dirname(path)
+  if dirname:
+    os.makedirs(dirname, exist_ok=True)
+  _Unlink(path)
+  # Ninja compares the output's timestamp with its inputs, so the restored
+  # output has to look freshly written. A hardlink would share its timestamp
+  # with the blob and with every other build directory that restored it, so
+  # the output gets an inode of its own.
+  shutil.copyfile(blob, path)
+  shutil.copymode(blob, path)
+
+
+def _MarkUsed(blob):
+  """Marks a blob as recently used for eviction. Blobs are never linked into
+  build directories, so their timestamps belong to the cache alone. Returns
+  False if the blob was evicted."""
+  try:
+    os.utime(blob, None)
+    return True
+  except FileNotFoundError:
+    return False
+
+
+class ActionCache(object):
+
+  def __init__(self, cache_dir, max_size_mb):
+    self._cache_dir = cache_dir
+    self._max_size = max_size_mb * 1024 * 1024
+    self._blob_dir = os.path.join(cache_dir, 'cas')
+    self._manifest_dir = os.path.join(cache_dir, 'manifests')
+    os.makedirs(self._blob_dir, exist_ok=True)
+    os.makedirs(self._manifest_dir, exist_ok=True)
+
+  @contextlib.contextmanager
+  def _Locked(self):
+    with open(os.path.join(self._cache_dir, 'lock'), 'a+') as lock_file:
+      _LockFile(lock_file)
+      try:
+        yield
+      finally:
+        _UnlockFile(lock_file)
+
+  def _StatsPath(self):
+    return os.path.join(self._cache_dir, 'stats.json')
+
+  def ReadStats(self):
+    try:
+      with open(self._StatsPath(), 'r') as stats_file:
+        return json.load(stats_file)
+    except (IOError, ValueError):
+      return {'hits': 0, 'misses': 0, 'size': 0, 'evicted': 0}
+
+  def _UpdateStats(self, hits=0, misses=0, added_bytes=0):
+    with self._Locked():
+      stats = self.ReadStats()
+      stats['hits'] += hits
+      stats['misses'] += misses
+      stats['size'] += added_bytes
+      if stats['size'] > self._max_size:
+        self._Evict(stats)
+      with open(self._StatsPath(), 'w') as stats_file:
+        json.dump(stats, stats_file, sort_keys=True)
+
+  def _Evict(self, stats):
+    """Evicts the least recently used blobs until the cache is at 90% of its
+    maximum size. Must be called with the lock held."""
+    blobs = []
+    total = 0
+    for root, _, files in os.walk(self._blob_dir):
+      for f in files:
+        path = os.path.join(root, f)
+        st = os.stat(path)
+        blobs.append((st.st_mtime, st.st_size, path))
+        total += st.st_size
+    blobs.sort()
+    target = self._max_size * 9 // 10
+    for _, size, path in blobs:
+      if total <= target:
+        break
+      # Manifests that point at evicted blobs become misses.
+      _Unlink(path)
+      total -= size
+      stats['evicted'] += 1
+    stats['size'] = total
+
+  def _BlobPath(self, digest):
+    return os.path.join(self._blob_dir, digest[:2], digest)
+
+  def _StoreBlob(self, path):
+    """Adds the file at path to the cache. Returns its digest and the number
+    of bytes the cache grew by."""
+    digest = _HashFile(path)
+    blob = self._BlobPath(digest)
+    if _MarkUsed(blob):
+      return digest, 0
+    os.makedirs(os.path.dirname(blob), exist_ok=True)
+    fd, tmp = tempfile.mkstemp(dir=os.path.dirname(blob))
+    os.close(fd)
+    shutil.copy2(path, tmp)
+    os.replace(tmp, blob)
+    return digest, os.path.getsize(blob)
+
+  def _ManifestPath(self, key):
+    return os.path.join(self._manifest_dir, key[:2], key + '.json')
+
+  def _ReadManifest(self, key):
+    try:
+      with open(self._ManifestPath(key), 'r') as manifest:
+        return json.load(manifest)
+    except (IOError, ValueError):
+      return []
+
+  def ComputeKey(self, command, inputs, outputs, depfile):
+    key = hashlib.sha256()
+    key.update(json.dumps({
+        'version': _CACHE_VERSION,
+        'tool': _HashFile(command[0]),
+        'args': command[1:],
+        'inputs': [(i, _HashFile(i)) for i in inputs],
+        'outputs': outputs,
+        'depfile': depfile,
+    }, sort_keys=True).encode('utf-8'))
+    return key.hexdigest()
+
+  def Lookup(self, key, outputs, depfile):
+    """Restores the outputs for key. Returns whether it was a hit."""
+    for entry in self._ReadManifest(key):
+      try:
+        if any(_HashFile(dep) != digest
+               for dep, digest in entry['deps'].items()):
+          continue
+      except IOError:
+        continue
+      blobs = [self._BlobPath(entry['outputs'][o]) for o in outputs]
+      if depfile:
+        blobs.append(self._BlobPath(entry['depfile']))
+      if not all(os.path.exists(b) for b in blobs):
+        continue
+      paths = outputs + ([depfile] if depfile else [])
+      try:
+        for blob, path in zip(blobs, paths):
+          _Restore(blob, path)
+      except FileNotFoundError:
+        # Another action evicted a blob since the check above. Don't leave a
+        # partial set of outputs behind.
+        for path in paths:
+          _Unlink(path)
+        continue
+      for blob in blobs:
+        _MarkUsed(blob)
+      self._UpdateStats(hits=1)
+      return True
+    return False
+
+  def Store(self, key, outputs, depfile):
+    """Records the outputs of a successful run of the action for key."""
+    added_bytes = 0
+    entry = {'outputs': {}, 'deps': {}}
+    for output in outputs:
+      entry['outputs'][output], size = self._StoreBlob(output)
+      added_bytes += size
+    if depfile:
+      entry['depfile'], size = self._StoreBlob(depfile)
+      added_bytes += size
+      for dep in _ParseDepfile(depfile):
+        if os.path.isfile(dep):
+          entry['deps'][dep] = _HashFile(dep)
+
+    manifest_path = self._ManifestPath(key)
+    os.makedirs(os.path.dirname(manifest_path), exist_ok=True)
+    with self._Locked():
+      entries = [e for e in self._ReadManifest(key) if e != entry]
+      entries = [entry] + entries[:_MAX_MANIFEST_ENTRIES - 1]
+      fd, tmp = tempfile.mkstemp(dir=os.path.dirname(manifest_path))
+      with os.fdopen(fd, 'w') as manifest:
+        json.dump(entries, manifest, sort_keys=True)
+      os.replace(tmp, manifest_path)
+    self._UpdateStats(misses=1, added_bytes=added_bytes)
+
+
+def RunCached(run, command, options):
+  """Runs an action through the cache described by |options|.
+
+  Args:
+    run: A function that runs the action and returns its exit code.
+    command: The tool followed by its arguments. Only used for the key.
+    options: Parsed arguments added by AddArguments.
+  Returns:
+    The exit code of the action.
+  """
+  if not options.cache_dir:
+    return run()
+
+  outputs = options.cache_output
+  depfile = options.cache_depfile
+  cache = ActionCache(options.cache_dir, options.cache_max_size_mb)
+  key = cache.ComputeKey(command, options.cache_input, outputs, depfile)
+  if cache.Lookup(key, outputs, depfile):
+    return 0
+
+  # Remove stale outputs so that only outputs written by this run are stored.
+  for path in outputs + ([depfile] if depfile else []):
+    _Unlink(path)
+
+  returncode = run()
+  if returncode == 0 and all(os.path.isfile(o) for o in outputs):
+    cache.Store(key, outputs, depfile)
+  return returncode
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__)
+  parser.add_argument('--cache-dir', required=True)
+  parser.add_argument('--stats',
+                      action='store_true',
+                      help='Print the hit and miss counts.')
+  parser.add_argument('--clear',
+                      action='store_true',
+                      help='Delete every cached result.')
+  args = parser.parse_args()
+
+  if args.clear:
+    shutil.rmtree(args.cache_dir, ignore_errors=True)
+  if not args.stats:
+    return 0
+
+  cache = ActionCache(args.cache_dir, 0)
+  stats = cache.ReadStats()
+  lookups = stats['hits'] + stats['misses']
+  hit_rate = 100.0 * stats['hits'] / lookups if lookups else 0.0
+  print('hits:    %d (%.1f%%)' % (stats['hits'], hit_rate))
+  print('misses:  %d' % stats['misses'])
+  print('evicted: %d' % stats['evicted'])
+  print('size:    %.1f MB' % (stats['size'] / (1024.0 * 1024.0)))
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -9,7 +9,6 @@
 import optparse
 import os
 import sys
-import zipfile
 
 from util import build_utils
 
@@ -28,31 +27,33 @@ def main(args):
     'output', 'dist_jar', 'native_lib', 'android_abi'
   ])
 
-  input_deps = []
+  input_deps = [options.dist_jar] + options.native_lib
+  native_lib_entries = [
+      ('lib/%s/%s' % (options.android_abi, os.path.basename(native_lib)),
+       native_lib) for native_lib in options.native_lib]
 
-  with zipfile.ZipFile(options.output, 'w', zipfile.ZIP_DEFLATED) as out_zip:
-    input_deps.append(options.dist_jar)
-    with zipfile.ZipFile(options.dist_jar, 'r') as dist_zip:
-      for dist_file in dist_zip.infolist():
-        if dist_file.filename.endswith('.class'):
-          out_zip.writestr(dist_file.filename, dist_zip.read(dist_file.filename))
+  # The native libraries are compressed once, for the native jar, and then
+  # copied from there without recompressing them.
+  if options.output_native_jar:
+    with build_utils.ZipWriter(options.output_native_jar) as out_zip:
+      out_zip.AddFiles(native_lib_entries, compress=True)
 
-    for native_lib in options.native_lib:
-      input_deps.append(native_lib)
-      out_zip.write(native_lib,
-                    'lib/%s/%s' % (options.android_abi, os.path.basename(native_lib)))
+  with build_utils.ZipWriter(options.output) as out_zip:
+    out_zip.AddZip(options.dist_jar, include_patterns=['*.class'])
 
-    if options.asset_dir:
-      for asset_file in os.listdir(options.asset_dir):
-        input_deps.append(asset_file)
-        out_zip.write(os.path.join(options.asset_dir, asset_file),
-                      'assets/flutter_shared/%s' % asset_file)
+    if options.output_native_jar:
+      out_zip.AddZip(options.output_native_jar)
+    else:
+      out_zip.AddFiles(native_lib_entries, compress=True)
 
-  if options.output_native_jar:
-    with zipfile.ZipFile(options.output_native_jar, 'w', zipfile.ZIP_DEFLATED) as out_zip:
-      for native_lib in options.native_lib:
-        out_zip.write(native_lib,
-                      'lib/%s/%s' % (options.android_abi, os.path.basename(native_lib)))
+    if options.asset_dir:
+      asset_entries = []
+      for asset_file in sorted(os.listdir(options.asset_dir)):
+        asset_path = os.path.join(options.asset_dir, asset_file)
+        input_deps.append(asset_path)
+        asset_entries.append(
+            ('assets/flutter_shared/%s' % asset_file, asset_path))
+      out_zip.AddFiles(asset_entries, compress=True)
 
   if options.depfile:
     build_utils.WriteDepfile(
@@ -29,17 +29,35 @@ def Jar(class_files, classes_dir, jar_path, jar_bin, manifest_file=None, additio
   if additional_jar_files:
     jar_cmd.extend(additional_jar_files)
 
+  # The empty file below lives in a fresh temporary directory on every run, so
+  # it must not be part of the recorded command.
+  input_strings = list(jar_cmd)
+
+  def DoJar(changes):
+    # When class files were only added or modified, update them in place
+    # instead of recreating the whole jar.
+    class_file_set = set(class_files)
+    changed_paths = list(changes.IterChangedPaths())
+    if (os.path.exists(jar_path) and changes.AddedOrModifiedOnly() and
+        all(p in class_file_set for p in changed_paths)):
+      update_cmd = [jar_bin, 'uf0', jar_path]
+      update_cmd.extend(os.path.relpath(p, jar_cwd) for p in changed_paths)
+      build_utils.CheckOutput(update_cmd, cwd=jar_cwd)
+    else:
+      build_utils.CheckOutput(jar_cmd, cwd=jar_cwd)
+
   with build_utils.TempDir() as temp_dir:
     empty_file = os.path.join(temp_dir, '.empty')
     build_utils.Touch(empty_file)
     jar_cmd.append(os.path.relpath(empty_file, jar_cwd))
     record_path = '%s.md5.stamp' % jar_path
     md5_check.CallAndRecordIfStale(
-        lambda: build_utils.CheckOutput(jar_cmd, cwd=jar_cwd),
+        DoJar,
         record_path=record_path,
         input_paths=class_files,
-        input_strings=jar_cmd,
+        input_strings=input_strings,
         force=not os.path.exists(jar_path),
+        pass_changes=True,
         )
 
     build_utils.Touch(jar_path, fail_if_missing=True)
@@ -3,6 +3,8 @@
 # found in the LICENSE file.
 
 import ast
+import collections
+import concurrent.futures
 import contextlib
 import fnmatch
 import json
@@ -11,10 +13,13 @@ import pipes
 import re
 import shlex
 import shutil
+import stat
+import struct
 import subprocess
 import sys
 import tempfile
 import zipfile
+import zlib
 
 
 # Definition copied from pylib/constants/__init__.py to avoid adding
@@ -221,39 +226,220 @@ def ExtractAll(zip_path, path=None, no_clobber=True, pattern=None):
     z.extractall(path=path)
 
 
-def DoZip(inputs, output, base_dir):
-  with zipfile.ZipFile(output, 'w') as outfile:
-    for f in inputs:
-      CheckZipPath(os.path.relpath(f, base_dir))
-      outfile.write(f, os.path.relpath(f, base_dir))
+# All entries written by ZipWriter get this timestamp so that zips only change
+# when their contents do.
+HERMETIC_TIMESTAMP = (2001, 1, 1, 0, 0, 0)
+
+_ZIP_LOCAL_HEADER = struct.Struct('<IHHHHHIIIHH')
+_ZIP_CENTRAL_HEADER = struct.Struct('<IHHHHHHIIIHHHHHII')
+_ZIP_END_OF_CENTRAL_DIRECTORY = struct.Struct('<IHHHHIIH')
+_ZIP_VERSION = 20
+_ZIP_FLAG_ENCRYPTED = 0x1
+_ZIP_FLAG_UTF8 = 0x800
+_ZIP_MAX_ENTRIES = 0xffff
+_ZIP_MAX_OFFSET = 0xffffffff
+
+
+def _DosTimestamp(date_time):
+  year, month, day, hour, minute, second = date_time
+  return (((year - 1980) << 9) | (month << 5) | day,
+          (hour << 11) | (minute << 5) | (second // 2))
+
+
+def _ReadAndCompress(fs_path, compress):
+  """Returns the compression method, CRC, size, external attributes and
+  possibly compressed contents of the file or directory at fs_path."""
+  mode = os.stat(fs_path).st_mode
+  if stat.S_ISDIR(mode):
+    return zipfile.ZIP_STORED, 0, 0, (stat.S_IFDIR | 0o755) << 16, b''
+  with open(fs_path, 'rb') as f:
+    data = f.read()
+  perms = 0o755 if mode & 0o111 else 0o644
+  external_attr = (stat.S_IFREG | perms) << 16
+  crc = zlib.crc32(data)
+  if compress:
+    # zlib releases the GIL, so this runs in parallel on a thread pool.
+    compressor = zlib.compressobj(zlib.Z_DEFAULT_COMPRESSION, zlib.DEFLATED,
+                                  -15)
+    compressed = compressor.compress(data) + compressor.flush()
+    # Incompressible files, such as already-compressed assets, are stored.
+    if len(compressed) < len(data):
+      return zipfile.ZIP_DEFLATED, crc, len(data), external_attr, compressed
+  return zipfile.ZIP_STORED, crc, len(data), external_attr, data
+
+
+class ZipWriter(object):
+  """Writes a deterministic zip file.
+
+  Unlike zipfile, entries of other zips are copied without being decompressed
+  and recompressed, and new files are read and compressed on a thread pool.
+  New files are stored unless compression is requested. Every entry gets
+  HERMETIC_TIMESTAMP. Zip64 is not supported.
+
+  Use as a context manager:
+    with build_utils.ZipWriter(output) as writer:
+      writer.AddZip(dist_jar, include_patterns=['*.class'])
+      writer.AddFiles([('lib/arm64-v8a/libfoo.so', libfoo_path)],
+                      compress=True)
+  """
 
+  def __init__(self, path):
+    self._file = open(path, 'wb')
+    self._central_directory = []
+    self._names = set()
+    self._date, self._time = _DosTimestamp(HERMETIC_TIMESTAMP)
+
+  def __enter__(self):
+    return self
+
+  def __exit__(self, exc_type, exc_value, traceback):
+    if exc_type is None:
+      self.Close()
+    else:
+      # Don't leave a truncated zip behind.
+      self._file.close()
+      os.unlink(self._file.name)
+
+  def HasEntry(self, name):
+    return name in self._names
+
+  def _AddEntry(self, name, method, crc, compressed_data, size, external_attr):
+    offset = self._file.tell()
+    if (len(self._central_directory) >= _ZIP_MAX_ENTRIES or
+        offset + len(compressed_data) > _ZIP_MAX_OFFSET):
+      raise Exception('Zip64 is not supported: %s' % self._file.name)
+    encoded_name = name.encode('utf-8')
+    flags = 0 if name.isascii() else _ZIP_FLAG_UTF8
+    self._file.write(_ZIP_LOCAL_HEADER.pack(
+        0x04034b50, _ZIP_VERSION, flags, method, self._time, self._date, crc,
+        len(compressed_data), size, len(encoded_name), 0))
+    self._file.write(encoded_name)
+    self._file.write(compressed_data)
+    self._central_directory.append(_ZIP_CENTRAL_HEADER.pack(
+        0x02014b50, (3 << 8) | _ZIP_VERSION, _ZIP_VERSION, flags, method,
+        self._time, self._date, crc, len(compressed_data), size,
+        len(encoded_name), 0, 0, 0, 0, external_attr, offset) + encoded_name)
+    self._names.add(name)
+
+  def AddFiles(self, entries, compress=False):
+    """Adds files from disk.
+
+    Args:
+      entries: (archive path, file system path) tuples, added in order.
+      compress: Whether to deflate the files. By default they are stored, like
+          zipfile does.
+    """
+    entries = list(entries)
+    for name, _ in entries:
+      CheckZipPath(name.rstrip('/'))
+      if name in self._names:
+        raise Exception('Duplicate zip entry: %s' % name)
+    workers = os.cpu_count() or 1
+    with concurrent.futures.ThreadPoolExecutor(max_workers=workers) as executor:
+      # Bound the number of files that are read or compressed ahead of the
+      # writer, so that large trees aren't held in memory all at once.
+      max_pending = 2 * workers
+      pending = collections.deque()
+      for name, fs_path in entries:
+        pending.append(
+            (name, executor.submit(_ReadAndCompress, fs_path, compress)))
+        if len(pending) >= max_pending:
+          self._AddCompressed(*pending.popleft())
+      while pending:
+        self._AddCompressed(*pending.popleft())
+
+  def _AddCompressed(self, name, future):
+    method, crc, size, external_attr, data = future.result()
+    if stat.S_ISDIR(external_attr >> 16) and not name.endswith('/'):
+      name += '/'
+    if name in self._names:
+      raise Exception('Duplicate zip entry: %s' % name)
+    self._AddEntry(name, method, crc, data, size, external_attr)
+
+  def AddZip(self, path, exclude_patterns=None, include_patterns=None):
+    """Copies the entries of the zip at path, keeping their compression.
+
+    Entries are selected from the central directory alone, so excluded
+    entries are never read. Entries whose name was already added are skipped.
+    """
+    def Allow(name):
+      if name in self._names:
+        return False
+      if include_patterns is not None and not any(
+          fnmatch.fnmatch(name, p) for p in include_patterns):
+        return False
+      if exclude_patterns is not None and any(
+          fnmatch.fnmatch(name, p) for p in exclude_patterns):
+        return False
+      return True
 
-def ZipDir(output, base_dir):
-  with zipfile.ZipFile(output, 'w') as outfile:
-    for root, _, files in os.walk(base_dir):
-      for f in files:
-        path = os.path.join(root, f)
-        archive_path = os.path.relpath(path, base_dir)
-        CheckZipPath(archive_path)
-        outfile.write(path, archive_path)
+    with zipfile.ZipFile(path, 'r') as in_zip:
+      infos = [i for i in in_zip.infolist() if Allow(i.filename)]
+      # Read in file order so that the copy is a sequential scan.
+      infos.sort(key=lambda i: i.header_offset)
+      with open(path, 'rb') as in_file:
+        for info in infos:
+          if info.filename in self._names:
+            continue
+          if (info.flag_bits & _ZIP_FLAG_ENCRYPTED or info.compress_type
+              not in (zipfile.ZIP_STORED, zipfile.ZIP_DEFLATED)):
+            # Can't be copied as is. Recompress it instead.
+            data = in_zip.read(info)
+            compressor = zlib.compressobj(zlib.Z_DEFAULT_COMPRESSION,
+                                          zlib.DEFLATED, -15)
+            self._AddEntry(info.filename, zipfile.ZIP_DEFLATED,
+                           zlib.crc32(data),
+                           compressor.compress(data) + compressor.flush(),
+                           len(data), info.external_attr)
+            continue
+          # The central directory has the sizes and CRC even when the local
+          # header defers them to a data descriptor.
+          in_file.seek(info.header_offset)
+          header = _ZIP_LOCAL_HEADER.unpack(
+              in_file.read(_ZIP_LOCAL_HEADER.size))
+          name_length, extra_length = header[9], header[10]
+          in_file.seek(name_length + extra_length, os.SEEK_CUR)
+          self._AddEntry(info.filename, info.compress_type, info.CRC,
+                         in_file.read(info.compress_size), info.file_size,
+                         info.external_attr)
+
+  def Close(self):
+    start = self._file.tell()
+    for header in self._central_directory:
+      self._file.write(header)
+    size = self._file.tell() - start
+    self._file.write(_ZIP_END_OF_CENTRAL_DIRECTORY.pack(
+        0x06054b50, 0, 0, len(self._central_directory),
+        len(self._central_directory), size, start, 0))
+    self._file.close()
+
+
+def DoZip(inputs, output, base_dir, compress=False):
+  """Zips inputs, naming each entry after its path relative to base_dir."""
+  with ZipWriter(output) as writer:
+    writer.AddFiles(((os.path.relpath(f, base_dir), f) for f in inputs),
+                    compress=compress)
+
+
+def ZipDir(output, base_dir, compress=False):
+  """Zips all files below base_dir in a deterministic order."""
+  entries = []
+  for root, dirs, files in os.walk(base_dir):
+    dirs.sort()
+    for f in sorted(files):
+      path = os.path.join(root, f)
+      entries.append((os.path.relpath(path, base_dir), path))
+  with ZipWriter(output) as writer:
+    writer.AddFiles(entries, compress=compress)
 
 
 def MergeZips(output, inputs, exclude_patterns=None):
-  added_names = set()
-  def Allow(name):
-    if exclude_patterns is not None:
-      for p in exclude_patterns:
-        if fnmatch.fnmatch(name, p):
-          return False
-    return True
-
-  with zipfile.ZipFile(output, 'w') as out_zip:
+  """Merges the entries of the zips in inputs. When several inputs have an
+  entry with the same name, the first one wins. Entries are copied without
+  being recompressed."""
+  with ZipWriter(output) as writer:
     for in_file in inputs:
-      with zipfile.ZipFile(in_file, 'r') as in_zip:
-        for name in in_zip.namelist():
-          if name not in added_names and Allow(name):
-            out_zip.writestr(name, in_zip.read(name))
-            added_names.add(name)
+      writer.AddZip(in_file, exclude_patterns=exclude_patterns)
 
 
 def PrintWarning(message):
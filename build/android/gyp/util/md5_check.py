@@ -2,21 +2,37 @@
 # Use of this source code is governed by a BSD-style license that can be
 # found in the LICENSE file.
 
+import concurrent.futures
 import hashlib
+import json
 import os
 
 
+# Bump this whenever the record format changes so that old records are treated
+# as stale rather than misread.
+_RECORD_VERSION = 2
+
+_HASH_BLOCK_SIZE = 2**20
+
+
 def CallAndRecordIfStale(
     function, record_path=None, input_paths=None, input_strings=None,
-    force=False):
-  """Calls function if the md5sum of the input paths/strings has changed.
+    force=False, pass_changes=False):
+  """Calls function if any of the input paths/strings has changed.
 
-  The md5sum of the inputs is compared with the one stored in record_path. If
-  this has changed (or the record doesn't exist), function will be called and
-  the new md5sum will be recorded.
+  A fingerprint of every input file and of the input strings is compared with
+  the ones stored in record_path. If any of them has changed (or the record
+  doesn't exist), function will be called and the new fingerprints will be
+  recorded. Directories in input_paths stand for all files below them.
+
+  Files are only rehashed when their size or modification time differs from
+  the record, so checking unchanged inputs costs a stat() per file.
 
   If force is True, the function will be called regardless of whether the
-  md5sum is out of date.
+  fingerprints are out of date.
+
+  If pass_changes is True, function is called with a Changes object describing
+  which inputs changed, so that it can do incremental work.
   """
   if not input_paths:
     input_paths = []
@@ -26,31 +42,137 @@ def CallAndRecordIfStale(
       record_path=record_path,
       input_paths=input_paths,
       input_strings=input_strings)
-  if force or md5_checker.IsStale():
-    function()
+  changes = Changes(md5_checker.old_record, md5_checker.new_record)
+  if force or changes.HasChanges():
+    if pass_changes:
+      function(changes)
+    else:
+      function()
+    md5_checker.Write()
+  elif md5_checker.old_record != md5_checker.new_record:
+    # Only sizes or modification times changed. Refresh them so that the files
+    # aren't rehashed again next time.
     md5_checker.Write()
 
 
-def _UpdateMd5ForFile(md5, path, block_size=2**16):
+class Changes(object):
+  """Describes how the inputs differ from the previous recorded run."""
+
+  def __init__(self, old_record, new_record):
+    self._old_record = old_record
+    self._new_record = new_record
+
+  def _OldFiles(self):
+    if self._old_record is None:
+      return {}
+    return self._old_record['files']
+
+  def _NewFiles(self):
+    return self._new_record['files']
+
+  def HasChanges(self):
+    """Whether anything changed since the previous run."""
+    if self._old_record is None:
+      return True
+    if self._old_record['strings'] != self._new_record['strings']:
+      return True
+    return any(self.IterChangedPaths())
+
+  def AddedOrModifiedOnly(self):
+    """Whether the only changes were added or modified input files.
+
+    When this is False (no previous record, changed input strings or removed
+    files), callers must redo all of their work.
+    """
+    return (self._old_record is not None
+            and self._old_record['strings'] == self._new_record['strings']
+            and not any(self.IterRemovedPaths()))
+
+  def IterAddedPaths(self):
+    old_files = self._OldFiles()
+    for path in sorted(self._NewFiles()):
+      if path not in old_files:
+        yield path
+
+  def IterModifiedPaths(self):
+    old_files = self._OldFiles()
+    for path, fingerprint in sorted(self._NewFiles().items()):
+      if path in old_files and old_files[path]['digest'] != fingerprint['digest']:
+        yield path
+
+  def IterRemovedPaths(self):
+    new_files = self._NewFiles()
+    for path in sorted(self._OldFiles()):
+      if path not in new_files:
+        yield path
+
+  def IterChangedPaths(self):
+    """Yields all added, modified and removed paths."""
+    for path in self.IterAddedPaths():
+      yield path
+    for path in self.IterModifiedPaths():
+      yield path
+    for path in self.IterRemovedPaths():
+      yield path
+
+  def DescribeDifference(self):
+    """Returns a human-readable description of what changed."""
+    if self._old_record is None:
+      return 'Previous record does not exist.'
+    if self._old_record['strings'] != self._new_record['strings']:
+      return 'Input strings changed.'
+    lines = []
+    lines.extend('Added: ' + p for p in self.IterAddedPaths())
+    lines.extend('Modified: ' + p for p in self.IterModifiedPaths())
+    lines.extend('Removed: ' + p for p in self.IterRemovedPaths())
+    return '\n'.join(lines)
+
+
+def _HashFile(path):
+  # blake2b is faster than md5 on 64-bit hosts, and hashlib releases the GIL
+  # while hashing so files can be hashed on a thread pool.
+  digest = hashlib.blake2b(digest_size=16)
   with open(path, 'rb') as infile:
     while True:
-      data = infile.read(block_size)
+      data = infile.read(_HASH_BLOCK_SIZE)
       if not data:
         break
-      md5.update(data)
-
-
-def _UpdateMd5ForDirectory(md5, dir_path):
-  for root, _, files in os.walk(dir_path):
-    for f in files:
-      _UpdateMd5ForFile(md5, os.path.join(root, f))
-
-
-def _UpdateMd5ForPath(md5, path):
-  if os.path.isdir(path):
-    _UpdateMd5ForDirectory(md5, path)
-  else:
-    _UpdateMd5ForFile(md5, path)
+      digest.update(data)
+  return digest.hexdigest()
+
+
+def _ExpandPaths(input_paths):
+  for path in input_paths:
+    if os.path.isdir(path):
+      for root, _, files in os.walk(path):
+        for f in files:
+          yield os.path.join(root, f)
+    else:
+      yield path
+
+
+def _Fingerprint(path, old_files):
+  """Returns the fingerprint of path, reusing old_files when the size and
+  modification time are unchanged."""
+  st = os.stat(path)
+  old = old_files.get(path)
+  if old and old['size'] == st.st_size and old['mtime'] == st.st_mtime_ns:
+    return old
+  return {'size': st.st_size, 'mtime': st.st_mtime_ns, 'digest': None}
+
+
+def _ReadRecord(record_path):
+  if not os.path.exists(record_path):
+    return None
+  try:
+    with open(record_path, 'r') as old_record:
+      record = json.load(old_record)
+  except ValueError:
+    # Records written before the fingerprint store were a bare md5 digest.
+    return None
+  if not isinstance(record, dict) or record.get('version') != _RECORD_VERSION:
+    return None
+  return record
 
 
 class _Md5Checker(object):
@@ -65,22 +187,35 @@ class _Md5Checker(object):
         'and delete')
 
     self.record_path = record_path
+    self.old_record = _ReadRecord(record_path)
+    old_files = self.old_record['files'] if self.old_record else {}
+
+    files = {}
+    for path in sorted(set(_ExpandPaths(input_paths))):
+      files[path] = _Fingerprint(path, old_files)
+
+    stale_paths = [p for p, f in files.items() if f['digest'] is None]
+    if stale_paths:
+      with concurrent.futures.ThreadPoolExecutor() as executor:
+        for path, digest in zip(stale_paths,
+                                executor.map(_HashFile, stale_paths)):
+          files[path]['digest'] = digest
 
-    md5 = hashlib.md5()
-    for i in sorted(input_paths):
-      _UpdateMd5ForPath(md5, i)
+    strings_digest = hashlib.blake2b(digest_size=16)
     for s in input_strings:
-      md5.update(s.encode('utf-8'))
-    self.new_digest = md5.hexdigest()
+      strings_digest.update(s.encode('utf-8'))
+      # Separate the strings so that ['ab', 'c'] and ['a', 'bc'] differ.
+      strings_digest.update(b'\0')
 
-    self.old_digest = ''
-    if os.path.exists(self.record_path):
-      with open(self.record_path, 'r') as old_record:
-        self.old_digest = old_record.read()
+    self.new_record = {
+        'version': _RECORD_VERSION,
+        'strings': strings_digest.hexdigest(),
+        'files': files,
+    }
 
   def IsStale(self):
-    return self.old_digest != self.new_digest
+    return Changes(self.old_record, self.new_record).HasChanges()
 
   def Write(self):
     with open(self.record_path, 'w') as new_record:
-      new_record.write(self.new_digest)
+      json.dump(self.new_record, new_record, sort_keys=True)
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+#
+# Copyright 2013 The Flutter Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+"""Merges .profraw files into an indexed .profdata file. See pgo.gni.
+
+Run with:
+  python merge_pgo_profiles.py --llvm-profdata <path> --output <out.profdata>
+      <profraw file or directory> [...]
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+
+
+def _CollectProfiles(paths):
+  profiles = []
+  for path in paths:
+    if os.path.isdir(path):
+      for root, _, files in os.walk(path):
+        profiles.extend(
+            os.path.join(root, f) for f in sorted(files)
+            if f.endswith('.profraw'))
+    else:
+      profiles.append(path)
+  return profiles
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__)
+  parser.add_argument('--llvm-profdata', required=True,
+                      help='Path to the llvm-profdata binary.')
+  parser.add_argument('--output', required=True,
+                      help='Path of the merged .profdata file to write.')
+  parser.add_argument('inputs', nargs='+',
+                      help='.profraw files or directories containing them.')
+  args = parser.parse_args()
+
+  profiles = _CollectProfiles(args.inputs)
+  if not profiles:
+    print('No .profraw files found in: ' + ' '.join(args.inputs))
+    return 1
+
+  # Write to a temporary file first so that an interrupted merge never leaves
+  # a truncated profile behind for the profile-use build to pick up.
+  tmp_output = args.output + '.tmp'
+  command = [args.llvm_profdata, 'merge', '-sparse', '-o', tmp_output
+            ] + profiles
+  try:
+    subprocess.check_output(command, stderr=subprocess.STDOUT)
+  except subprocess.CalledProcessError as ex:
+    print('Command failed: ' + ' '.join(command))
+    print('exitCode: ' + str(ex.returncode))
+    print(ex.output.decode('utf-8', errors='replace'))
+    return ex.returncode
+  os.replace(tmp_output, args.output)
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -5,24 +5,47 @@
 """Helper script for GN to run an arbitrary binary. See compiled_action.gni.
 
 Run with:
-  python gn_run_binary.py <binary_name> [args ...]
+  python gn_run_binary.py [cache flags --] <binary_name> [args ...]
+
+The optional cache flags are described in action_cache.py.
 """
 
+import argparse
 import sys
 import subprocess
 
+argv = sys.argv[1:]
+cache_options = None
+if argv and argv[0].startswith('--'):
+  # Only imported when the cache is enabled, so that runs without it don't
+  # depend on anything beyond the standard library.
+  import action_cache
+  separator = argv.index('--')
+  parser = argparse.ArgumentParser()
+  action_cache.AddArguments(parser)
+  cache_options = parser.parse_args(argv[:separator])
+  argv = argv[separator + 1:]
+
 # This script is designed to run binaries produced by the current build. We
 # always prefix it with "./" to avoid picking up system versions that might
 # also be on the path.
-path = './' + sys.argv[1]
+path = './' + argv[0]
 
 # The rest of the arguements are passed directly to the executable.
-args = [path] + sys.argv[2:]
-
-try:
-  subprocess.check_output(args, stderr=subprocess.STDOUT)
-except subprocess.CalledProcessError as ex:
-  print("Command failed: " + ' '.join(args))
-  print("exitCode: " + str(ex.returncode))
-  print(ex.output.decode('utf-8', errors='replace'))
-  sys.exit(ex.returncode)
+args = [path] + argv[1:]
+
+
+def Run():
+  try:
+    subprocess.check_output(args, stderr=subprocess.STDOUT)
+  except subprocess.CalledProcessError as ex:
+    print("Command failed: " + ' '.join(args))
+    print("exitCode: " + str(ex.returncode))
+    print(ex.output.decode('utf-8', errors='replace'))
+    return ex.returncode
+  return 0
+
+
+if cache_options is None:
+  sys.exit(Run())
+sys.exit(action_cache.RunCached(Run, args, cache_options))
@@ -10,45 +10,68 @@ json output file. This script attempts to read the output file and dump it to
 stdout upon failure.
 
 Run with:
-  python gn_run_malioc.py <binary_name> <output_path> [args ...]
+  python gn_run_malioc.py [cache flags --] <binary_name> <output_path> [args ...]
+
+The optional cache flags are described in action_cache.py.
 """
 
+import argparse
 import json
 import os
 import sys
 import subprocess
 
+argv = sys.argv[1:]
+cache_options = None
+if argv and argv[0].startswith('--'):
+  # Only imported when the cache is enabled, so that runs without it don't
+  # depend on anything beyond the standard library.
+  import action_cache
+  separator = argv.index('--')
+  parser = argparse.ArgumentParser()
+  action_cache.AddArguments(parser)
+  cache_options = parser.parse_args(argv[:separator])
+  argv = argv[separator + 1:]
+
 # This script is designed to run binaries produced by the current build. We
 # always prefix it with "./" to avoid picking up system versions that might
 # also be on the path.
-path = './' + sys.argv[1]
+path = './' + argv[0]
 
-malioc_output = sys.argv[2]
+malioc_output = argv[1]
 
 # The rest of the arguements are passed directly to the executable.
-args = [path, '--output', malioc_output] + sys.argv[3:]
-
-try:
-  subprocess.check_output(args, stderr=subprocess.STDOUT)
-except subprocess.CalledProcessError as ex:
-  print(ex.output.decode('utf-8', errors='replace'))
-  if os.path.exists(malioc_output):
-    with open(malioc_output, 'r') as malioc_file:
-      malioc_json = malioc_file.read()
-
-    print('malioc output:')
-    # Attempt to pretty print the json output, but fall back to printing the
-    # raw output if doing so fails.
-    try:
-      parsed = json.loads(malioc_json)
-      print(json.dumps(parsed, indent=2))
-    except:
-      print(malioc_json)
-
-  else:
-    print(
-        'Unable to find the malioc output file in order to print contained'
-        'errors:',
-        malioc_output,
-    )
-  sys.exit(ex.returncode)
+args = [path, '--output', malioc_output] + argv[2:]
+
+
+def Run():
+  try:
+    subprocess.check_output(args, stderr=subprocess.STDOUT)
+  except subprocess.CalledProcessError as ex:
+    print(ex.output.decode('utf-8', errors='replace'))
+    if os.path.exists(malioc_output):
+      with open(malioc_output, 'r') as malioc_file:
+        malioc_json = malioc_file.read()
+
+      print('malioc output:')
+      # Attempt to pretty print the json output, but fall back to printing the
+      # raw output if doing so fails.
+      try:
+        parsed = json.loads(malioc_json)
+        print(json.dumps(parsed, indent=2))
+      except:
+        print(malioc_json)
+
+    else:
+      print(
+          'Unable to find the malioc output file in order to print contained'
+          'errors:',
+          malioc_output,
+      )
+    return ex.returncode
+  return 0
+
+
+if cache_options is None:
+  sys.exit(Run())
+sys.exit(action_cache.RunCached(Run, args, cache_options))
@@ -2,11 +2,15 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
-// Precompiled header for Chromium project on Windows, not used by
-// other build configurations. Using precompiled headers speeds the
-// build up significantly, around 1/4th on VS 2010 on an HP Z600 with 12
+// Precompiled header shared by targets that use the
+// //build/config:precompiled_headers config. Using precompiled headers speeds
+// the build up significantly, around 1/4th on VS 2010 on an HP Z600 with 12
 // GB of memory.
 //
+// On Windows it is force-included through /FI. With the gcc_toolchain it is
+// compiled once per target and language and passed to every source file via
+// -include, so only the C and C++ standard headers below are used there.
+//
 // Numeric comments beside includes are the number of times they were
 // included under src/chrome/browser on 2011/8/20, which was used as a
 // baseline for deciding what to include in the PCH. Includes without
@@ -15,11 +19,13 @@
 // removing some of the less frequently used headers.
 
 #if defined(BUILD_PRECOMPILE_H_)
-#error You shouldn't include the precompiled header file more than once.
+#error The precompiled header file should not be included more than once.
 #endif
 
 #define BUILD_PRECOMPILE_H_
 
+#if defined(_WIN32)
+
 #define _USE_MATH_DEFINES
 
 // The Windows header needs to come before almost all the other
@@ -69,6 +75,8 @@
 // Caused other conflicts in addition to the 'interface' issue above.
 // #include <shlobj.h>
 
+#endif  // defined(_WIN32)
+
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>  // 4
@@ -82,6 +90,9 @@
 #include <string.h>
 #include <time.h>  // 4
 
+// The precompiled header is also built for C sources in mixed targets.
+#if defined(__cplusplus)
+
 #include <algorithm>
 #include <bitset>  // 3
 #include <cmath>
@@ -107,3 +118,5 @@
 #include <string>
 #include <utility>
 #include <vector>
+
+#endif  // defined(__cplusplus)
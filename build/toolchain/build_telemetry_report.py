@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+#
+# Copyright 2013 The Flutter Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+"""Summarizes the build telemetry collected with enable_build_telemetry.
+Usage: build_telemetry_report.py [--build-dir=<out dir>] [--top=N]
+                                 [--trace=<trace.json>]
+Ranks the slowest and most memory hungry actions and targets. When the build
+also used enable_time_trace, the per-translation-unit -ftime-trace files are
+aggregated to rank the most expensive headers and template instantiations.
+--trace writes all actions as a Chrome trace that can be loaded into
+chrome://tracing or https://ui.perfetto.dev.
+"""
+import argparse
+import collections
+import json
+import os
+import sys
+def _LoadRecords(log_path):
+  records = []
+  with open(log_path) as f:
+    for line in f:
+      line = line.strip()
+      if not line:
+        continue
+      try:
+        records.append(json.loads(line))
+      except ValueError:
+        # A record may be truncated if the build was interrupted.
+        continue
+  return records
+def _TargetOf(record):
+  """Maps an action to the target it belongs to.
+  Object files are named obj/<dir>/<target>.<source>.o by gcc_toolchain, so
+  the target is everything up to the first dot of the file name. Linked
+  outputs are their own target.
+  """
+  output = record.get('output') or '<unknown>'
+  if record['kind'] in ('cc', 'cxx', 'asm'):
+    dirname, basename = os.path.split(output)
+    return os.path.join(dirname, basename.split('.', 1)[0])
+  return output
+def _TimeTracePath(build_dir, record):
+  output = record.get('output')
+  if record['kind'] not in ('cc', 'cxx') or not output:
+    return None
+  return os.path.join(build_dir, os.path.splitext(output)[0] + '.json')
+def _AggregateTimeTraces(build_dir, records):
+  """Sums the time spent in each header and template across all traces."""
+  headers = collections.Counter()
+  templates = collections.Counter()
+  for record in records:
+    path = _TimeTracePath(build_dir, record)
+    if not path or not os.path.exists(path):
+      continue
+    try:
+      with open(path) as f:
+        events = json.load(f).get('traceEvents', [])
+    except ValueError:
+      continue
+    for event in events:
+      if event.get('ph') != 'X':
+        continue
+      detail = event.get('args', {}).get('detail')
+      if not detail:
+        continue
+      name = event.get('name')
+      if name == 'Source':
+        headers[detail] += event.get('dur', 0)
+      elif name in ('InstantiateClass', 'InstantiateFunction'):
+        templates[detail] += event.get('dur', 0)
+  return headers, templates
+def _PrintTable(title, rows, unit):
+  print(title)
+  for value, name in rows:
+    print('  %10.2f %s  %s' % (value, unit, name))
+  print('')
+def _WriteChromeTrace(records, trace_path):
+  """Writes |records| as complete events, packing overlapping actions into
+  separate lanes the way Ninja ran them."""
+  records = sorted(records, key=lambda r: r['start'])
+  base = records[0]['start'] if records else 0
+  lane_ends = []
+  events = []
+  for record in records:
+    for lane, end in enumerate(lane_ends):
+      if end <= record['start']:
+        break
+    else:
+      lane = len(lane_ends)
+      lane_ends.append(0)
+    lane_ends[lane] = record['start'] + record['wall']
+    events.append({
+        'name': record.get('output') or record['kind'],
+        'cat': record['kind'],
+        'ph': 'X',
+        'pid': 1,
+        'tid': lane,
+        'ts': int((record['start'] - base) * 1e6),
+        'dur': int(record['wall'] * 1e6),
+        'args': {
+            'user': record['user'],
+            'sys': record['sys'],
+            'max_rss_kb': record['max_rss_kb'],
+            'target': _TargetOf(record),
+        },
+    })
+  with open(trace_path, 'w') as f:
+    json.dump({'traceEvents': events, 'displayTimeUnit': 'ms'}, f)
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument('--build-dir',
+                      default='.',
+                      help='The build directory the telemetry was recorded in.')
+  parser.add_argument('--log',
+                      help='Telemetry log. Defaults to '
+                      '<build-dir>/build_telemetry.jsonl.')
+  parser.add_argument('--top',
+                      type=int,
+                      default=20,
+                      help='Number of entries to show per ranking.')
+  parser.add_argument('--trace', help='Write a Chrome trace to this file.')
+  args = parser.parse_args()
+  log_path = args.log or os.path.join(args.build_dir, 'build_telemetry.jsonl')
+  if not os.path.exists(log_path):
+    print('No telemetry log at %s. Was the build configured with '
+          'enable_build_telemetry = true?' % log_path)
+    return 1
+  records = _LoadRecords(log_path)
+  top = args.top
+  _PrintTable('Slowest actions (wall time):',
+              sorted(((r['wall'], r.get('output') or r['kind'])
+                      for r in records), reverse=True)[:top], 's ')
+  _PrintTable('Largest actions (peak RSS):',
+              sorted(((r['max_rss_kb'] / 1024.0, r.get('output') or r['kind'])
+                      for r in records), reverse=True)[:top], 'MB')
+  target_cpu = collections.Counter()
+  for record in records:
+    target_cpu[_TargetOf(record)] += record['user'] + record['sys']
+  _PrintTable('Most expensive targets (CPU time):',
+              [(t, name) for name, t in target_cpu.most_common(top)], 's ')
+  headers, templates = _AggregateTimeTraces(args.build_dir, records)
+  if headers:
+    _PrintTable('Most expensive headers (-ftime-trace, inclusive):',
+                [(us / 1e6, name) for name, us in headers.most_common(top)],
+                's ')
+  if templates:
+    _PrintTable('Most expensive template instantiations (-ftime-trace):',
+                [(us / 1e6, name) for name, us in templates.most_common(top)],
+                's ')
+  if args.trace:
+    _WriteChromeTrace(records, args.trace)
+    print('Wrote %s' % args.trace)
+  return 0
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+#
+# Copyright 2013 The Flutter Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+"""Records the wall time, CPU time and peak RSS of a toolchain command.
+Usage: build_telemetry_wrapper.py --kind=<tool> [--log=<file>] -- <command>
+Each invocation appends one JSON record to the log. The records are
+aggregated by build_telemetry_report.py.
+"""
+import argparse
+import json
+import os
+import re
+import sys
+import wrapper_utils
+def _FindOutput(args):
+  """Returns the value of the -o flag in |args|, if any."""
+  for i, arg in enumerate(args):
+    if arg == '-o' and i + 1 < len(args):
+      return args[i + 1]
+    if arg.startswith('-o') and len(arg) > 2:
+      return arg[2:]
+  return None
+def _FindArchive(args):
+  """Returns the archive of an `ar <operation> <archive> ...` command."""
+  for i, arg in enumerate(args[1:-1], 1):
+    if re.match(r'^-?[dmpqrtx][a-zA-Z]*$', arg):
+      return args[i + 1]
+  return None
+def _AppendRecord(log_path, record):
+  # A single write to a file opened with O_APPEND is atomic for records of
+  # this size, so parallel actions can share the log without locking.
+  line = (json.dumps(record, sort_keys=True) + '\n').encode('utf-8')
+  fd = os.open(log_path, os.O_WRONLY | os.O_APPEND | os.O_CREAT, 0o644)
+  try:
+    os.write(fd, line)
+  finally:
+    os.close(fd)
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument('--kind',
+                      required=True,
+                      help='Name of the toolchain tool being run.')
+  parser.add_argument('--log',
+                      default='build_telemetry.jsonl',
+                      help='File the record is appended to.')
+  parser.add_argument('args', nargs=argparse.REMAINDER)
+  parsed_args = parser.parse_args()
+  command = parsed_args.args
+  if command and command[0] == '--':
+    command = command[1:]
+  returncode, usage = wrapper_utils.RunWithResourceUsage(
+      wrapper_utils.CommandToRun(command))
+  record = dict(usage)
+  record['kind'] = parsed_args.kind
+  if parsed_args.kind == 'alink':
+    record['output'] = _FindArchive(command)
+  else:
+    record['output'] = _FindOutput(command)
+  record['returncode'] = returncode
+  _AppendRecord(parsed_args.log, record)
+  return returncode
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,770 @@
+// Copyright 2013 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Post-link step for the gcc_toolchain solink and link tools. See
+// //build/toolchain/elf_toc/BUILD.gn.
+//
+// Memory-maps a linked ELF file and, in a single pass over it:
+//  - writes its table of contents (the SONAME and the dynamic symbol table)
+//    to a .TOC file, only touching the file when the contents changed, and
+//  - writes a stripped copy that keeps only the sections needed at runtime.
+//
+// This replaces a readelf | grep, nm | cut, cmp, mv and strip pipeline.
+//
+// Usage:
+//   elf_toc --input=<elf> [--toc=<toc file>] [--stripped=<output>]
+//           [--only-if-changed]
+//
+// With --only-if-changed, an existing stripped output with the same contents
+// is left untouched, like the .TOC file always is.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+// The subset of the ELF format used below. These mirror the definitions in
+// <elf.h>, which isn't available on every host.
+constexpr unsigned char kElfMagic[] = {0x7f, 'E', 'L', 'F'};
+constexpr int kEiClass = 4;
+constexpr int kEiData = 5;
+constexpr unsigned char kElfClass32 = 1;
+constexpr unsigned char kElfClass64 = 2;
+constexpr unsigned char kElfData2Lsb = 1;
+
+constexpr uint32_t kShtNobits = 8;
+constexpr uint32_t kShtRela = 4;
+constexpr uint32_t kShtRel = 9;
+constexpr uint32_t kShtDynamic = 6;
+constexpr uint32_t kShtDynsym = 11;
+constexpr uint32_t kShtGnuVerdef = 0x6ffffffd;
+constexpr uint32_t kShtGnuVerneed = 0x6ffffffe;
+constexpr uint32_t kShtGnuVersym = 0x6fffffff;
+constexpr uint64_t kShfWrite = 0x1;
+constexpr uint64_t kShfAlloc = 0x2;
+constexpr uint64_t kShfExecinstr = 0x4;
+constexpr uint64_t kShfInfoLink = 0x40;
+constexpr uint16_t kShnUndef = 0;
+constexpr uint16_t kShnLoReserve = 0xff00;
+constexpr uint16_t kShnAbs = 0xfff1;
+
+constexpr int64_t kDtNull = 0;
+constexpr int64_t kDtSoname = 14;
+
+constexpr uint16_t kVerFlgBase = 0x1;
+constexpr uint16_t kVersymHidden = 0x8000;
+constexpr uint16_t kVersymGlobal = 1;
+
+constexpr unsigned char kStbLocal = 0;
+constexpr unsigned char kStbWeak = 2;
+constexpr unsigned char kStbGnuUnique = 10;
+constexpr unsigned char kSttObject = 1;
+constexpr unsigned char kSttGnuIfunc = 10;
+
+// The symbol versioning structures are the same for both classes.
+struct Verdef {
+  uint16_t vd_version;
+  uint16_t vd_flags;
+  uint16_t vd_ndx;
+  uint16_t vd_cnt;
+  uint32_t vd_hash;
+  uint32_t vd_aux;
+  uint32_t vd_next;
+};
+
+struct Verdaux {
+  uint32_t vda_name;
+  uint32_t vda_next;
+};
+
+struct Verneed {
+  uint16_t vn_version;
+  uint16_t vn_cnt;
+  uint32_t vn_file;
+  uint32_t vn_aux;
+  uint32_t vn_next;
+};
+
+struct Vernaux {
+  uint32_t vna_hash;
+  uint16_t vna_flags;
+  uint16_t vna_other;
+  uint32_t vna_name;
+  uint32_t vna_next;
+};
+
+struct Elf32 {
+  struct Ehdr {
+    unsigned char e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint32_t e_entry;
+    uint32_t e_phoff;
+    uint32_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+  };
+  struct Phdr {
+    uint32_t p_type;
+    uint32_t p_offset;
+    uint32_t p_vaddr;
+    uint32_t p_paddr;
+    uint32_t p_filesz;
+    uint32_t p_memsz;
+    uint32_t p_flags;
+    uint32_t p_align;
+  };
+  struct Shdr {
+    uint32_t sh_name;
+    uint32_t sh_type;
+    uint32_t sh_flags;
+    uint32_t sh_addr;
+    uint32_t sh_offset;
+    uint32_t sh_size;
+    uint32_t sh_link;
+    uint32_t sh_info;
+    uint32_t sh_addralign;
+    uint32_t sh_entsize;
+  };
+  struct Sym {
+    uint32_t st_name;
+    uint32_t st_value;
+    uint32_t st_size;
+    unsigned char st_info;
+    unsigned char st_other;
+    uint16_t st_shndx;
+  };
+  struct Dyn {
+    int32_t d_tag;
+    uint32_t d_val;
+  };
+};
+
+struct Elf64 {
+  struct Ehdr {
+    unsigned char e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint64_t e_entry;
+    uint64_t e_phoff;
+    uint64_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+  };
+  struct Phdr {
+    uint32_t p_type;
+    uint32_t p_flags;
+    uint64_t p_offset;
+    uint64_t p_vaddr;
+    uint64_t p_paddr;
+    uint64_t p_filesz;
+    uint64_t p_memsz;
+    uint64_t p_align;
+  };
+  struct Shdr {
+    uint32_t sh_name;
+    uint32_t sh_type;
+    uint64_t sh_flags;
+    uint64_t sh_addr;
+    uint64_t sh_offset;
+    uint64_t sh_size;
+    uint32_t sh_link;
+    uint32_t sh_info;
+    uint64_t sh_addralign;
+    uint64_t sh_entsize;
+  };
+  struct Sym {
+    uint32_t st_name;
+    unsigned char st_info;
+    unsigned char st_other;
+    uint16_t st_shndx;
+    uint64_t st_value;
+    uint64_t st_size;
+  };
+  struct Dyn {
+    int64_t d_tag;
+    uint64_t d_val;
+  };
+};
+
+bool Error(const std::string& path, const std::string& message) {
+  fprintf(stderr, "elf_toc: %s: %s\n", path.c_str(), message.c_str());
+  return false;
+}
+
+// A read-only memory mapping of a whole file.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool Open(const std::string& path) {
+    fd_ = open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+      return Error(path, strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+      return Error(path, strerror(errno));
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    mode_ = st.st_mode & 0777;
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (data == MAP_FAILED) {
+      return Error(path, strerror(errno));
+    }
+    data_ = static_cast<const char*>(data);
+    return true;
+  }
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+  mode_t mode() const { return mode_; }
+
+ private:
+  int fd_ = -1;
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  mode_t mode_ = 0;
+};
+
+// Writes |size| bytes at |offset| of |fd|, retrying on short writes.
+bool WriteAt(int fd, const void* data, size_t size, uint64_t offset) {
+  const char* p = static_cast<const char*>(data);
+  while (size > 0) {
+    ssize_t written = pwrite(fd, p, size, static_cast<off_t>(offset));
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    p += written;
+    size -= static_cast<size_t>(written);
+    offset += static_cast<uint64_t>(written);
+  }
+  return true;
+}
+
+// Writes |contents| to |path| unless the file already has these contents, so
+// that Ninja's restat can skip relinking the dependents.
+bool WriteIfChanged(const std::string& path, const std::string& contents) {
+  FILE* existing = fopen(path.c_str(), "rb");
+  if (existing != nullptr) {
+    std::string old_contents;
+    char buffer[1 << 16];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), existing)) > 0) {
+      old_contents.append(buffer, read);
+    }
+    fclose(existing);
+    if (old_contents == contents) {
+      return true;
+    }
+  }
+  std::string temp_path = path + ".tmp";
+  FILE* out = fopen(temp_path.c_str(), "wb");
+  if (out == nullptr) {
+    return Error(temp_path, strerror(errno));
+  }
+  bool ok = fwrite(contents.data(), 1, contents.size(), out) == contents.size();
+  ok = (fclose(out) == 0) && ok;
+  if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+    return Error(path, strerror(errno));
+  }
+  return true;
+}
+
+// Whether the files at |a| and |b| exist and have the same contents.
+bool SameContents(const std::string& a, const std::string& b) {
+  FILE* file_a = fopen(a.c_str(), "rb");
+  FILE* file_b = fopen(b.c_str(), "rb");
+  bool same = file_a != nullptr && file_b != nullptr;
+  char buffer_a[1 << 16];
+  char buffer_b[1 << 16];
+  while (same) {
+    size_t read_a = fread(buffer_a, 1, sizeof(buffer_a), file_a);
+    size_t read_b = fread(buffer_b, 1, sizeof(buffer_b), file_b);
+    same = read_a == read_b && memcmp(buffer_a, buffer_b, read_a) == 0;
+    if (read_a == 0) {
+      break;
+    }
+  }
+  if (file_a != nullptr) {
+    fclose(file_a);
+  }
+  if (file_b != nullptr) {
+    fclose(file_b);
+  }
+  return same;
+}
+
+template <typename T>
+T Read(const char* data, uint64_t offset) {
+  T value;
+  memcpy(&value, data + offset, sizeof(T));
+  return value;
+}
+
+template <typename Elf>
+class ElfFile {
+ public:
+  using Ehdr = typename Elf::Ehdr;
+  using Phdr = typename Elf::Phdr;
+  using Shdr = typename Elf::Shdr;
+  using Sym = typename Elf::Sym;
+  using Dyn = typename Elf::Dyn;
+
+  ElfFile(const std::string& path, const MappedFile& file)
+      : path_(path), file_(file) {}
+
+  bool Parse() {
+    if (file_.size() < sizeof(Ehdr)) {
+      return Error(path_, "truncated ELF header");
+    }
+    ehdr_ = Read<Ehdr>(file_.data(), 0);
+    if (ehdr_.e_shnum == 0 || ehdr_.e_shstrndx >= ehdr_.e_shnum) {
+      return Error(path_, "unsupported section header table");
+    }
+    if (ehdr_.e_shentsize != sizeof(Shdr) ||
+        ehdr_.e_shoff + uint64_t{ehdr_.e_shnum} * sizeof(Shdr) >
+            file_.size()) {
+      return Error(path_, "truncated section header table");
+    }
+    if (ehdr_.e_phnum > 0 &&
+        (ehdr_.e_phentsize != sizeof(Phdr) ||
+         ehdr_.e_phoff + uint64_t{ehdr_.e_phnum} * sizeof(Phdr) >
+             file_.size())) {
+      return Error(path_, "truncated program header table");
+    }
+    for (uint16_t i = 0; i < ehdr_.e_shnum; ++i) {
+      Shdr shdr = Read<Shdr>(file_.data(), ehdr_.e_shoff + i * sizeof(Shdr));
+      if (shdr.sh_type != kShtNobits &&
+          shdr.sh_offset + shdr.sh_size > file_.size()) {
+        return Error(path_, "section extends past the end of the file");
+      }
+      shdrs_.push_back(shdr);
+    }
+    return true;
+  }
+
+  // Returns the SONAME line followed by one line per global dynamic symbol,
+  // in the same spirit as `readelf -d | grep SONAME` and `nm -gD -f posix`.
+  // Like nm, symbol names include their version, e.g. printf@GLIBC_2.2.5, so
+  // that a change to only the versioning also changes the TOC.
+  std::string Toc() const {
+    std::string toc;
+    std::vector<std::string> symbols;
+    std::map<uint16_t, std::string> versions = VersionNames();
+    for (const Shdr& shdr : shdrs_) {
+      if (shdr.sh_type == kShtDynamic && shdr.sh_link < shdrs_.size()) {
+        const Shdr& strtab = shdrs_[shdr.sh_link];
+        for (uint64_t offset = 0; offset + sizeof(Dyn) <= shdr.sh_size;
+             offset += sizeof(Dyn)) {
+          Dyn dyn = Read<Dyn>(file_.data(), shdr.sh_offset + offset);
+          if (dyn.d_tag == kDtNull) {
+            break;
+          }
+          if (dyn.d_tag == kDtSoname) {
+            toc += "SONAME " + String(strtab, dyn.d_val) + "\n";
+          }
+        }
+      } else if (shdr.sh_type == kShtDynsym && shdr.sh_link < shdrs_.size()) {
+        const Shdr& strtab = shdrs_[shdr.sh_link];
+        const Shdr* versym = FindVersym(&shdr);
+        // Entry 0 is the reserved null symbol.
+        for (uint64_t offset = sizeof(Sym);
+             offset + sizeof(Sym) <= shdr.sh_size;
+             offset += sizeof(Sym)) {
+          Sym sym = Read<Sym>(file_.data(), shdr.sh_offset + offset);
+          unsigned char bind = sym.st_info >> 4;
+          if (bind == kStbLocal) {
+            continue;
+          }
+          std::string name = String(strtab, sym.st_name);
+          uint64_t versym_offset = offset / sizeof(Sym) * sizeof(uint16_t);
+          if (versym != nullptr &&
+              versym_offset + sizeof(uint16_t) <= versym->sh_size) {
+            uint16_t version = Read<uint16_t>(
+                file_.data(), versym->sh_offset + versym_offset);
+            auto it = versions.find(version & ~kVersymHidden);
+            // The symbols that define the version names themselves are shown
+            // without a version.
+            if (it != versions.end() && it->second != name) {
+              // Like nm, the default version of a defined symbol gets "@@".
+              bool is_default = sym.st_shndx != kShnUndef &&
+                                !(version & kVersymHidden);
+              name += (is_default ? "@@" : "@") + it->second;
+            }
+          }
+          symbols.push_back(name + " " + SymbolType(sym));
+        }
+      }
+    }
+    std::sort(symbols.begin(), symbols.end());
+    for (const std::string& symbol : symbols) {
+      toc += symbol + "\n";
+    }
+    return toc;
+  }
+
+  // Writes a copy of the file without the sections that aren't needed at
+  // runtime, like `strip --strip-all`. Everything covered by a segment or by
+  // an allocated section is copied verbatim. Only the section header table,
+  // the section name table and the section indices in .dynsym are rewritten.
+  bool WriteStripped(const std::string& output, bool only_if_changed) const {
+    const size_t shnum = shdrs_.size();
+    std::vector<uint32_t> new_index(shnum, 0);
+    std::vector<uint16_t> kept;
+    for (size_t i = 0; i < shnum; ++i) {
+      if (Keep(i)) {
+        new_index[i] = static_cast<uint32_t>(kept.size());
+        kept.push_back(static_cast<uint16_t>(i));
+      }
+    }
+
+    // The end of the data that is copied verbatim.
+    uint64_t alloc_end = sizeof(Ehdr);
+    if (ehdr_.e_phnum > 0) {
+      alloc_end = std::max<uint64_t>(
+          alloc_end, ehdr_.e_phoff + uint64_t{ehdr_.e_phnum} * sizeof(Phdr));
+    }
+    for (uint16_t i = 0; i < ehdr_.e_phnum; ++i) {
+      Phdr phdr = Read<Phdr>(file_.data(), ehdr_.e_phoff + i * sizeof(Phdr));
+      alloc_end = std::max<uint64_t>(alloc_end, phdr.p_offset + phdr.p_filesz);
+    }
+    for (uint16_t i : kept) {
+      const Shdr& shdr = shdrs_[i];
+      if ((shdr.sh_flags & kShfAlloc) && shdr.sh_type != kShtNobits) {
+        alloc_end =
+            std::max<uint64_t>(alloc_end, shdr.sh_offset + shdr.sh_size);
+      }
+    }
+    if (alloc_end > file_.size()) {
+      return Error(path_, "segment extends past the end of the file");
+    }
+
+    std::string temp_path = output + ".tmp";
+    int fd =
+        open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, file_.mode());
+    if (fd < 0) {
+      return Error(temp_path, strerror(errno));
+    }
+    bool ok = WriteAt(fd, file_.data(), alloc_end, 0);
+
+    // Lay out the kept non-allocated sections after the allocated data and
+    // remap the section indices in the section headers.
+    uint64_t offset = alloc_end;
+    std::vector<Shdr> new_shdrs;
+    for (uint16_t i : kept) {
+      Shdr shdr = shdrs_[i];
+      if (i != 0 && !(shdr.sh_flags & kShfAlloc)) {
+        uint64_t align = std::max<uint64_t>(shdr.sh_addralign, 1);
+        offset = (offset + align - 1) / align * align;
+        ok = ok && WriteAt(fd, file_.data() + shdr.sh_offset, shdr.sh_size,
+                           offset);
+        shdr.sh_offset = offset;
+        offset += shdr.sh_size;
+      }
+      shdr.sh_link = shdr.sh_link < shnum ? new_index[shdr.sh_link] : 0;
+      if ((shdr.sh_flags & kShfInfoLink) || shdr.sh_type == kShtRel ||
+          shdr.sh_type == kShtRela) {
+        shdr.sh_info = shdr.sh_info < shnum ? new_index[shdr.sh_info] : 0;
+      }
+      new_shdrs.push_back(shdr);
+    }
+
+    // Dropped sections are almost always placed after the allocated ones, in
+    // which case the dynamic symbols' section indices are unchanged.
+    for (uint16_t i : kept) {
+      const Shdr& shdr = shdrs_[i];
+      if (shdr.sh_type != kShtDynsym || !RemapsAllocIndices(new_index)) {
+        continue;
+      }
+      for (uint64_t sym_offset = 0; sym_offset + sizeof(Sym) <= shdr.sh_size;
+           sym_offset += sizeof(Sym)) {
+        Sym sym = Read<Sym>(file_.data(), shdr.sh_offset + sym_offset);
+        if (sym.st_shndx == kShnUndef || sym.st_shndx >= kShnLoReserve ||
+            sym.st_shndx >= shnum) {
+          continue;
+        }
+        sym.st_shndx = static_cast<uint16_t>(new_index[sym.st_shndx]);
+        ok = ok && WriteAt(fd, &sym, sizeof(Sym), shdr.sh_offset + sym_offset);
+      }
+    }
+
+    uint64_t shoff = (offset + 7) / 8 * 8;
+    ok = ok && WriteAt(fd, new_shdrs.data(), new_shdrs.size() * sizeof(Shdr),
+                       shoff);
+
+    Ehdr ehdr = ehdr_;
+    ehdr.e_shoff = shoff;
+    ehdr.e_shnum = static_cast<uint16_t>(new_shdrs.size());
+    ehdr.e_shstrndx = static_cast<uint16_t>(new_index[ehdr_.e_shstrndx]);
+    ok = ok && WriteAt(fd, &ehdr, sizeof(Ehdr), 0);
+
+    ok = (close(fd) == 0) && ok;
+    if (ok && only_if_changed && SameContents(temp_path, output)) {
+      unlink(temp_path.c_str());
+      return true;
+    }
+    if (!ok || rename(temp_path.c_str(), output.c_str()) != 0) {
+      unlink(temp_path.c_str());
+      return Error(output, strerror(errno));
+    }
+    return true;
+  }
+
+ private:
+  std::string String(const Shdr& strtab, uint64_t offset) const {
+    if (offset >= strtab.sh_size) {
+      return std::string();
+    }
+    const char* start = file_.data() + strtab.sh_offset + offset;
+    return std::string(start, strnlen(start, strtab.sh_size - offset));
+  }
+
+  // Returns the .gnu.version section that belongs to |dynsym|, if any.
+  const Shdr* FindVersym(const Shdr* dynsym) const {
+    for (const Shdr& shdr : shdrs_) {
+      if (shdr.sh_type == kShtGnuVersym && shdr.sh_link < shdrs_.size() &&
+          &shdrs_[shdr.sh_link] == dynsym) {
+        return &shdr;
+      }
+    }
+    return nullptr;
+  }
+
+  // Maps the version indices used in .gnu.version to the version names
+  // defined in .gnu.version_d and required in .gnu.version_r. Indices 0 and 1
+  // (local and global) have no name.
+  std::map<uint16_t, std::string> VersionNames() const {
+    std::map<uint16_t, std::string> names;
+    for (const Shdr& shdr : shdrs_) {
+      if ((shdr.sh_type != kShtGnuVerdef && shdr.sh_type != kShtGnuVerneed) ||
+          shdr.sh_link >= shdrs_.size()) {
+        continue;
+      }
+      const Shdr& strtab = shdrs_[shdr.sh_link];
+      // sh_info is the number of entries.
+      uint64_t offset = 0;
+      for (uint32_t i = 0; i < shdr.sh_info; ++i) {
+        if (shdr.sh_type == kShtGnuVerdef) {
+          if (offset + sizeof(Verdef) > shdr.sh_size) {
+            break;
+          }
+          Verdef verdef = Read<Verdef>(file_.data(), shdr.sh_offset + offset);
+          uint64_t aux_offset = offset + verdef.vd_aux;
+          if (!(verdef.vd_flags & kVerFlgBase) && verdef.vd_cnt > 0 &&
+              aux_offset + sizeof(Verdaux) <= shdr.sh_size) {
+            Verdaux verdaux =
+                Read<Verdaux>(file_.data(), shdr.sh_offset + aux_offset);
+            names[verdef.vd_ndx] = String(strtab, verdaux.vda_name);
+          }
+          if (verdef.vd_next == 0) {
+            break;
+          }
+          offset += verdef.vd_next;
+        } else {
+          if (offset + sizeof(Verneed) > shdr.sh_size) {
+            break;
+          }
+          Verneed verneed =
+              Read<Verneed>(file_.data(), shdr.sh_offset + offset);
+          uint64_t aux_offset = offset + verneed.vn_aux;
+          for (uint16_t j = 0; j < verneed.vn_cnt; ++j) {
+            if (aux_offset + sizeof(Vernaux) > shdr.sh_size) {
+              break;
+            }
+            Vernaux vernaux =
+                Read<Vernaux>(file_.data(), shdr.sh_offset + aux_offset);
+            names[vernaux.vna_other & ~kVersymHidden] =
+                String(strtab, vernaux.vna_name);
+            if (vernaux.vna_next == 0) {
+              break;
+            }
+            aux_offset += vernaux.vna_next;
+          }
+          if (verneed.vn_next == 0) {
+            break;
+          }
+          offset += verneed.vn_next;
+        }
+      }
+    }
+    names.erase(0);
+    names.erase(kVersymGlobal);
+    return names;
+  }
+
+  // Returns the symbol type letter that nm would show for |sym|.
+  const char* SymbolType(const Sym& sym) const {
+    unsigned char bind = sym.st_info >> 4;
+    unsigned char type = sym.st_info & 0xf;
+    if (sym.st_shndx == kShnUndef) {
+      if (bind == kStbWeak) {
+        return type == kSttObject ? "v" : "w";
+      }
+      return "U";
+    }
+    if (sym.st_shndx == kShnAbs) {
+      return "A";
+    }
+    if (bind == kStbGnuUnique) {
+      return "u";
+    }
+    if (type == kSttGnuIfunc) {
+      return "i";
+    }
+    if (bind == kStbWeak) {
+      return type == kSttObject ? "V" : "W";
+    }
+    if (sym.st_shndx >= shdrs_.size()) {
+      return "?";
+    }
+    const Shdr& section = shdrs_[sym.st_shndx];
+    if (section.sh_flags & kShfExecinstr) {
+      return "T";
+    }
+    if (section.sh_type == kShtNobits) {
+      return "B";
+    }
+    return (section.sh_flags & kShfWrite) ? "D" : "R";
+  }
+
+  // Whether section |index| survives stripping.
+  bool Keep(size_t index) const {
+    if (index == 0 || index == ehdr_.e_shstrndx) {
+      return true;
+    }
+    const Shdr& shdr = shdrs_[index];
+    if (shdr.sh_flags & kShfAlloc) {
+      return true;
+    }
+    return String(shdrs_[ehdr_.e_shstrndx], shdr.sh_name) == ".gnu_debuglink";
+  }
+
+  bool RemapsAllocIndices(const std::vector<uint32_t>& new_index) const {
+    for (size_t i = 0; i < shdrs_.size(); ++i) {
+      if ((shdrs_[i].sh_flags & kShfAlloc) && new_index[i] != i) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  const std::string path_;
+  const MappedFile& file_;
+  Ehdr ehdr_;
+  std::vector<Shdr> shdrs_;
+};
+
+template <typename Elf>
+int Run(const std::string& input,
+        const MappedFile& file,
+        const std::string& toc,
+        const std::string& stripped,
+        bool only_if_changed) {
+  ElfFile<Elf> elf(input, file);
+  if (!elf.Parse()) {
+    return 1;
+  }
+  if (!toc.empty() && !WriteIfChanged(toc, elf.Toc())) {
+    return 1;
+  }
+  if (!stripped.empty() && !elf.WriteStripped(stripped, only_if_changed)) {
+    return 1;
+  }
+  return 0;
+}
+
+bool ParseFlag(const char* arg, const char* name, std::string* value) {
+  size_t length = strlen(name);
+  if (strncmp(arg, name, length) != 0 || arg[length] != '=') {
+    return false;
+  }
+  *value = arg + length + 1;
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string input;
+  std::string toc;
+  std::string stripped;
+  bool only_if_changed = false;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--only-if-changed") == 0) {
+      only_if_changed = true;
+    } else if (!ParseFlag(argv[i], "--input", &input) &&
+               !ParseFlag(argv[i], "--toc", &toc) &&
+               !ParseFlag(argv[i], "--stripped", &stripped)) {
+      fprintf(stderr, "elf_toc: unknown argument %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (input.empty() || (toc.empty() && stripped.empty())) {
+    fprintf(stderr,
+            "Usage: elf_toc --input=<elf> [--toc=<toc file>] "
+            "[--stripped=<output>] [--only-if-changed]\n");
+    return 1;
+  }
+
+  MappedFile file;
+  if (!file.Open(input)) {
+    return 1;
+  }
+  if (file.size() < 16 ||
+      memcmp(file.data(), kElfMagic, sizeof(kElfMagic)) != 0) {
+    Error(input, "not an ELF file");
+    return 1;
+  }
+  if (file.data()[kEiData] != kElfData2Lsb) {
+    Error(input, "only little-endian ELF files are supported");
+    return 1;
+  }
+  switch (file.data()[kEiClass]) {
+    case kElfClass32:
+      return Run<Elf32>(input, file, toc, stripped, only_if_changed);
+    case kElfClass64:
+      return Run<Elf64>(input, file, toc, stripped, only_if_changed);
+    default:
+      Error(input, "unknown ELF class");
+      return 1;
+  }
+}
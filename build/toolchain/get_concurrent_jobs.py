@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+#
+# Copyright 2013 The Flutter Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+"""Sizes the compile and link pools from the host's RAM. See
+concurrent_jobs.gni.
+Usage: get_concurrent_jobs.py [--history=<build_telemetry.jsonl>]
+Prints a GN scope. Per-action memory is estimated from the peak RSS recorded
+by enable_build_telemetry when a history is available, and from conservative
+defaults otherwise. Links whose recorded peak RSS is far above the typical
+link are reported as heavy, so that they can be given a lane of their own.
+"""
+import argparse
+import json
+import multiprocessing
+import os
+import subprocess
+import sys
+_GB = 1024 * 1024 * 1024
+# Used when there is no history for a class of actions.
+_DEFAULT_COMPILE_BYTES = 1 * _GB
+_DEFAULT_LINK_BYTES = 4 * _GB
+# Memory kept free for the OS, Ninja and everything else on the machine.
+_RESERVED_BYTES = 2 * _GB
+# A link is heavy when it needs this many times the typical link's memory.
+_HEAVY_LINK_FACTOR = 4
+def _TotalMemoryBytes():
+  if sys.platform.startswith('linux'):
+    with open('/proc/meminfo') as meminfo:
+      for line in meminfo:
+        if line.startswith('MemTotal:'):
+          return int(line.split()[1]) * 1024
+  elif sys.platform == 'darwin':
+    return int(subprocess.check_output(['sysctl', '-n', 'hw.memsize']))
+  # Assume a modest machine when the memory can't be determined.
+  return 8 * _GB
+def _Percentile(values, percentile):
+  values = sorted(values)
+  return values[min(len(values) - 1, len(values) * percentile // 100)]
+def _LoadHistory(history_path):
+  """Returns the peak RSS in bytes of the latest run of every output, keyed by
+  the kind of action."""
+  latest = {}
+  if not history_path or not os.path.exists(history_path):
+    return {}
+  with open(history_path) as log:
+    for line in log:
+      try:
+        record = json.loads(line)
+      except ValueError:
+        continue
+      if record.get('returncode') != 0 or not record.get('output'):
+        continue
+      latest[os.path.normpath(record['output'])] = record
+  history = {}
+  for output, record in latest.items():
+    if record['kind'] in ('cc', 'cxx', 'asm'):
+      kind = 'compile'
+    elif record['kind'] == 'link':
+      kind = 'link'
+    else:
+      continue
+    history.setdefault(kind, {})[output] = record['max_rss_kb'] * 1024
+  return history
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument('--history',
+                      help='Telemetry log to estimate per-action memory from.')
+  args = parser.parse_args()
+  memory = max(_GB, _TotalMemoryBytes() - _RESERVED_BYTES)
+  cpus = multiprocessing.cpu_count()
+  history = _LoadHistory(args.history)
+  compiles = history.get('compile', {})
+  compile_bytes = _DEFAULT_COMPILE_BYTES
+  if compiles:
+    compile_bytes = _Percentile(compiles.values(), 90)
+  links = history.get('link', {})
+  link_bytes = _DEFAULT_LINK_BYTES
+  heavy_links = []
+  heavy_link_bytes = 0
+  if links:
+    typical = _Percentile(links.values(), 50)
+    heavy_links = sorted(o for o, rss in links.items()
+                         if rss > typical * _HEAVY_LINK_FACTOR)
+    light = [rss for o, rss in links.items() if o not in heavy_links]
+    link_bytes = _Percentile(light, 90)
+    if heavy_links:
+      heavy_link_bytes = max(links[o] for o in heavy_links)
+  link_depth = max(1, min(cpus, memory // max(link_bytes, 1)))
+  heavy_link_depth = max(1, memory // max(heavy_link_bytes, link_bytes, 1))
+  if heavy_links:
+    # Heavy links run inside the link pool, and ones waiting for a heavy slot
+    # still hold their link slot. Keep at least half of the pool for the other
+    # links and take the heavy slots out of it.
+    heavy_link_depth = min(heavy_link_depth, max(1, link_depth // 2))
+    link_depth = max(1, link_depth - heavy_link_depth)
+  # Compiles are additionally bounded by Ninja's -j, so only memory matters.
+  print('compile_pool_depth = %d' % max(1, memory // max(compile_bytes, 1)))
+  print('link_pool_depth = %d' % link_depth)
+  print('heavy_link_depth = %d' % heavy_link_depth)
+  print('heavy_links = %s' % json.dumps(heavy_links))
+  return 0
+if __name__ == '__main__':
+  sys.exit(main())
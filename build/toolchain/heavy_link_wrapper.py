@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+#
+# Copyright 2013 The Flutter Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+"""Limits how many heavy links run at once. See concurrent_jobs.gni.
+Usage: heavy_link_wrapper.py --slots=<N> --heavy-links=<file> -- <command>
+GN can only assign a pool per tool, not per target, so heavy links share the
+link pool with everything else. This wrapper additionally makes every link
+listed in the heavy links file hold one of N lock files while it runs, so that
+a few huge binaries can't exhaust the machine's memory together.
+A heavy link that waits for a lock file still holds its link pool and Ninja
+slots, so get_concurrent_jobs.py takes the heavy slots out of the link pool.
+"""
+import argparse
+import fcntl
+import os
+import subprocess
+import sys
+import time
+import wrapper_utils
+def _FindOutput(args):
+  for i, arg in enumerate(args):
+    if arg == '-o' and i + 1 < len(args):
+      return args[i + 1]
+  return None
+def _AcquireSlot(lock_dir, slots):
+  """Blocks until one of |slots| lock files is free and returns it locked."""
+  while True:
+    for i in range(slots):
+      lock_file = open(os.path.join(lock_dir, 'heavy_link.%d.lock' % i), 'a')
+      try:
+        fcntl.flock(lock_file, fcntl.LOCK_EX | fcntl.LOCK_NB)
+        return lock_file
+      except (IOError, OSError):
+        lock_file.close()
+    time.sleep(0.5)
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument('--slots', type=int, required=True)
+  parser.add_argument('--heavy-links',
+                      required=True,
+                      help='File listing the outputs of heavy links.')
+  parser.add_argument('args', nargs=argparse.REMAINDER)
+  parsed_args = parser.parse_args()
+  command = parsed_args.args
+  if command and command[0] == '--':
+    command = command[1:]
+  heavy_links = set()
+  if os.path.exists(parsed_args.heavy_links):
+    with open(parsed_args.heavy_links) as f:
+      heavy_links = set(line.strip() for line in f if line.strip())
+  output = _FindOutput(command)
+  if output is None or os.path.normpath(output) not in heavy_links:
+    return subprocess.call(wrapper_utils.CommandToRun(command))
+  lock_dir = os.path.dirname(os.path.abspath(parsed_args.heavy_links))
+  with _AcquireSlot(lock_dir, parsed_args.slots):
+    return subprocess.call(wrapper_utils.CommandToRun(command))
+if __name__ == '__main__':
+  sys.exit(main())
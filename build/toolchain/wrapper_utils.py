@@ -10,6 +10,7 @@ import shlex
 import shutil
 import sys
 import threading
+import time
 _BAT_PREFIX = 'cmd /c call '
 def _GzipThenDelete(src_path, dest_path):
   # Results for Android map file with GCC on a z620:
@@ -70,3 +71,33 @@ def CaptureCommandStderr(command, env=None):
   child = subprocess.Popen(command, stderr=subprocess.PIPE, env=env)
   _, stderr = child.communicate()
   return child.returncode, stderr
+def RunWithResourceUsage(command, env=None):
+  """Runs a command and measures the resources it used.
+  The CPU times and peak RSS cover the command and every descendant process
+  it waited for, e.g. the cc1 process spawned by the clang driver.
+  Args:
+    command: A list containing the command and arguments.
+    env: Environment variables for the new process.
+  Returns:
+    A tuple of the exit code of |command| and a dict with its start time,
+    wall time and CPU times in seconds and its peak RSS in kilobytes.
+  """
+  start = time.time()
+  child = subprocess.Popen(command, env=env)
+  _, status, rusage = os.wait4(child.pid, 0)
+  wall = time.time() - start
+  if os.WIFSIGNALED(status):
+    child.returncode = -os.WTERMSIG(status)
+  else:
+    child.returncode = os.WEXITSTATUS(status)
+  max_rss_kb = rusage.ru_maxrss
+  if sys.platform == 'darwin':
+    # macOS reports ru_maxrss in bytes rather than kilobytes.
+    max_rss_kb //= 1024
+  return child.returncode, {
+      'start': start,
+      'wall': wall,
+      'user': rusage.ru_utime,
+      'sys': rusage.ru_stime,
+      'max_rss_kb': max_rss_kb,
+  }